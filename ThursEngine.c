@@ -14,6 +14,7 @@
 
 #include <raylib.h>
 #include <math.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -21,6 +22,12 @@
 #define MAP_WIDTH		 64
 #define MAP_HEIGHT		 64
 #define NUM_RAYS		 640
+#define RAY_MAX_TRACE	 16
+#define RAY_LINK_POOL	( NUM_RAYS * RAY_MAX_TRACE )
+
+#define FIX_SHIFT		 16
+#define FIX_ONE			( 1 << FIX_SHIFT )
+#define FIX_ANGLES		 16384	// Angle steps per full turn in fixed point mode
 
 #define TEXTURE_WIDTH	 64
 #define SCREEN_H		800
@@ -29,6 +36,13 @@
 #define NUM_ENTITIES	  6
 #define MAX_PARTICLES	100
 
+#define AI_MAX_INTERVAL		  8		// Far entities think every 8th tick
+#define AI_SCAN_PER_TICK	256		// Entities the scheduler may look at per tick
+#define AI_BUDGET_PER_TICK	 64		// Entity updates allowed per tick
+#define AI_MAX_STEP		  0.25f	// Longest single step when catching up accumulated dt
+#define AI_MAX_CATCHUP	  1.0f	// Accumulated dt beyond this is dropped
+#define WANDER_NUDGE	( 2.0f / 60.0f )	// Wander step scale, one 60 fps frame
+
 #define PI	3.14159265358979323846f
 #define CLAMP(value, min, max) ((value) < (min) ? (min) : ((value) > (max) ? (max) : (value)))
 
@@ -47,6 +61,10 @@ typedef struct {
 	float		speed;
 	Color		color;
 	int			behavior;		// 0 = chase, 1 = wander, 2 = stationary
+	float		wanderTimer;
+	double		lastUpdate;		// Scheduler clock at the last update
+	unsigned int nextTick;		// Scheduler tick the entity is due again
+	int			interval;		// Ticks between updates, 1 = on the nearby list
 } Entity;
 Entity entities[NUM_ENTITIES];
 
@@ -119,28 +137,59 @@ int GetMapValue( Map* m, int x, int y ) {
 	return m->data[y * m->width + x];
 }
 
+// Door cells a ray passed through. Doors are the only tiles that change
+// at runtime, so these are the only cells the ray cache has to track.
+typedef struct {
+	int			cells[RAY_MAX_TRACE];
+	int			count;
+	bool		overflow;
+} RayTrace;
+
+// Test the cell a ray just stepped into, recording doors in the trace.
+bool RayHitsCell( Map* m, int mapX, int mapY, int* hitType, RayTrace* trace ) {
+	int tile = GetMapValue( m, mapX, mapY );
+	if( tile == 2 && trace ) {
+		if( trace->count < RAY_MAX_TRACE ) {
+			trace->cells[trace->count++] = mapY * m->width + mapX;
+		} else {
+			trace->overflow = true;
+		}
+	}
+	if( tile == 1 || ( tile == 2 && m->doorOpenness[mapY * m->width + mapX] < 0.5f ) ) {
+		if( tile == 2 ) {
+			*hitType = 2; // Door hit
+		}
+		return true;
+	}
+	return false;
+}
+
 // Cast rays using DDA algorithm to return the distance to the wall,
 // the side hit, and calculates the texture x-coordinate.
-float CastRay( const Player* player, Map* m, float angle, int* side, int* texX, int* hitType ) {
-	float		sinA = sinf( angle );
-	float		cosA = cosf( angle );
-
+// The distance is in units of the direction's length, so a unit vector
+// gives euclidean distance and a camera-plane ray gives perpendicular
+// distance. Pass a trace to record the door cells visited, or NULL.
+float CastRayDir( const Player* player, Map* m, float dirX, float dirY, int* side, int* texX, int* hitType, RayTrace* trace ) {
 	int			mapX = ( int )player->x;
 	int			mapY = ( int )player->y;
 
-	float		deltaDistX = fabsf( 1.0f / cosA );
-	float		deltaDistY = fabsf( 1.0f / sinA );
+	float		deltaDistX = fabsf( 1.0f / dirX );
+	float		deltaDistY = fabsf( 1.0f / dirY );
 
-	int			stepX = ( cosA < 0 ) ? -1 : 1;
-	int			stepY = ( sinA < 0 ) ? -1 : 1;
+	int			stepX = ( dirX < 0 ) ? -1 : 1;
+	int			stepY = ( dirY < 0 ) ? -1 : 1;
 
-	float		sideDistX = ( cosA < 0 ) ? ( player->x - mapX ) * deltaDistX : ( mapX + 1.0f - player->x ) * deltaDistX;
-	float		sideDistY = ( sinA < 0 ) ? ( player->y - mapY ) * deltaDistY : ( mapY + 1.0f - player->y ) * deltaDistY;
+	float		sideDistX = ( dirX < 0 ) ? ( player->x - mapX ) * deltaDistX : ( mapX + 1.0f - player->x ) * deltaDistX;
+	float		sideDistY = ( dirY < 0 ) ? ( player->y - mapY ) * deltaDistY : ( mapY + 1.0f - player->y ) * deltaDistY;
 
 	float		distance = 0.0f;
 	bool		hit = false;
 
 	*hitType = 0; // Default: No special hit
+	if( trace ) {
+		trace->count = 0;
+		trace->overflow = false;
+	}
 
 	//Color shade = ( Color ){ 255, 255, 255, 255 };
 
@@ -157,21 +206,15 @@ float CastRay( const Player* player, Map* m, float angle, int* side, int* texX,
 			distance = sideDistY - deltaDistY;
 		}
 
-		int tile = GetMapValue( m, mapX, mapY );
-		if( tile == 1 || ( tile == 2 && m->doorOpenness[mapY * m->width + mapX] < 0.5f ) ) {
-			hit = true;
-			if( tile == 2 ) {
-				*hitType = 2; // Door hit
-			}
-		}
+		hit = RayHitsCell( m, mapX, mapY, hitType, trace );
 	}
 
 	// Determine exact location of where map was hit to map the texture.
 	float wallHit;
 	if( *side == 0 ) {
-		wallHit = player->y + distance * sinA;
+		wallHit = player->y + distance * dirY;
 	} else {
-		wallHit = player->x + distance * cosA;
+		wallHit = player->x + distance * dirX;
 	}
 	wallHit -= floorf( wallHit );
 	*texX = ( int )roundf( wallHit * TEXTURE_WIDTH );
@@ -184,6 +227,325 @@ float CastRay( const Player* player, Map* m, float angle, int* side, int* texX,
 	return distance;
 }
 
+float CastRay( const Player* player, Map* m, float angle, int* side, int* texX, int* hitType, RayTrace* trace ) {
+	return CastRayDir( player, m, cosf( angle ), sinf( angle ), side, texX, hitType, trace );
+}
+
+//=======================
+// FIXED POINT
+//=======================
+// 16.16 fixed point DDA. Sines come from a table built with integer math
+// only, so the same pose gives bit-identical results on every platform.
+
+int32_t fixSinTable[FIX_ANGLES / 4 + 1];
+bool fixSinTableReady = false;
+
+// Fill the quarter-wave sine table from a Taylor series in Q30.
+void InitFixSinTable( void ) {
+	const int64_t halfPiQ30 = 1686629713LL;	// PI / 2 * 2^30
+	const int quarter = FIX_ANGLES / 4;
+
+	for( int k = 0; k <= quarter; k++ ) {
+		int64_t x = halfPiQ30 * k / quarter;
+		int64_t x2 = ( x * x ) >> 30;
+		int64_t term = x;
+		int64_t sum = x;
+		for( int n = 1; n <= 8; n++ ) {
+			term = ( ( term * x2 ) >> 30 ) / ( ( 2 * n ) * ( 2 * n + 1 ) );
+			sum += ( n & 1 ) ? -term : term;
+		}
+		int64_t value = ( sum + ( 1 << 13 ) ) >> 14;
+		fixSinTable[k] = ( int32_t )( value > FIX_ONE ? FIX_ONE : value );
+	}
+	fixSinTableReady = true;
+}
+
+int32_t FixSin( int k ) {
+	const int quarter = FIX_ANGLES / 4;
+	k %= FIX_ANGLES;
+	if( k < 0 ) k += FIX_ANGLES;
+
+	int r = k % quarter;
+	switch( k / quarter ) {
+		case 0:  return fixSinTable[r];
+		case 1:  return fixSinTable[quarter - r];
+		case 2:  return -fixSinTable[r];
+		default: return -fixSinTable[quarter - r];
+	}
+}
+
+int32_t FixCos( int k ) {
+	return FixSin( k + FIX_ANGLES / 4 );
+}
+
+// Multiply two 16.16 values. Division keeps rounding defined for negatives.
+int32_t FixMul( int32_t a, int32_t b ) {
+	return ( int32_t )( ( ( int64_t )a * b ) / FIX_ONE );
+}
+
+// Quantize an angle in radians to table steps.
+int FixAngle( float angle ) {
+	int k = ( int )floorf( angle * ( FIX_ANGLES / ( 2 * PI ) ) + 0.5f );
+	k %= FIX_ANGLES;
+	if( k < 0 ) k += FIX_ANGLES;
+	return k;
+}
+
+// Fixed point version of CastRayDir, direction given in 16.16.
+float CastRayFixed( const Player* player, Map* m, int32_t dirX, int32_t dirY, int* side, int* texX, int* hitType, RayTrace* trace ) {
+	const int64_t	maxDist = ( int64_t )16 << FIX_SHIFT;
+	const int64_t	farAway = INT64_C( 1 ) << 48;
+
+	int32_t		posX = ( int32_t )( player->x * FIX_ONE );
+	int32_t		posY = ( int32_t )( player->y * FIX_ONE );
+
+	int			mapX = posX >> FIX_SHIFT;
+	int			mapY = posY >> FIX_SHIFT;
+
+	int64_t		deltaDistX = dirX ? ( ( int64_t )FIX_ONE << FIX_SHIFT ) / llabs( dirX ) : farAway;
+	int64_t		deltaDistY = dirY ? ( ( int64_t )FIX_ONE << FIX_SHIFT ) / llabs( dirY ) : farAway;
+
+	int			stepX = ( dirX < 0 ) ? -1 : 1;
+	int			stepY = ( dirY < 0 ) ? -1 : 1;
+
+	int64_t		fracX = ( dirX < 0 ) ? posX - ( ( int64_t )mapX << FIX_SHIFT ) : ( ( int64_t )( mapX + 1 ) << FIX_SHIFT ) - posX;
+	int64_t		fracY = ( dirY < 0 ) ? posY - ( ( int64_t )mapY << FIX_SHIFT ) : ( ( int64_t )( mapY + 1 ) << FIX_SHIFT ) - posY;
+	int64_t		sideDistX = dirX ? ( fracX * deltaDistX ) >> FIX_SHIFT : farAway;
+	int64_t		sideDistY = dirY ? ( fracY * deltaDistY ) >> FIX_SHIFT : farAway;
+
+	int64_t		distance = 0;
+	bool		hit = false;
+
+	*hitType = 0;
+	if( trace ) {
+		trace->count = 0;
+		trace->overflow = false;
+	}
+
+	while( !hit && distance < maxDist ) {
+		if( sideDistX < sideDistY ) {
+			sideDistX += deltaDistX;
+			mapX += stepX;
+			*side = 0;
+			distance = sideDistX - deltaDistX;
+		} else {
+			sideDistY += deltaDistY;
+			mapY += stepY;
+			*side = 1;
+			distance = sideDistY - deltaDistY;
+		}
+
+		hit = RayHitsCell( m, mapX, mapY, hitType, trace );
+	}
+
+	// Hit position in 32.32 so the sum stays positive before shifting.
+	int64_t wallHit;
+	if( *side == 0 ) {
+		wallHit = ( ( int64_t )posY << FIX_SHIFT ) + distance * dirY;
+	} else {
+		wallHit = ( ( int64_t )posX << FIX_SHIFT ) + distance * dirX;
+	}
+	if( wallHit < 0 ) wallHit = 0;
+	int64_t frac = ( wallHit >> FIX_SHIFT ) & ( FIX_ONE - 1 );
+	*texX = ( int )( ( frac * TEXTURE_WIDTH + FIX_ONE / 2 ) >> FIX_SHIFT );
+	if( *texX >= TEXTURE_WIDTH ) *texX = TEXTURE_WIDTH - 1;
+
+	return ( float )distance / FIX_ONE;
+}
+
+//=======================
+// RAY CAMERA
+//=======================
+// Rays are spread evenly across a camera plane instead of by equal angle,
+// which removes the stretching at the screen edges. The per-column plane
+// offsets only depend on the column count and FOV, so they are built once
+// and every frame just adds them to the view direction.
+
+typedef struct {
+	bool		ready;
+	bool		fixedPoint;		// Use the platform independent fixed point DDA
+	float		fov;			// FOV the tables were built for
+	float		projectedPlane;
+	float		offset[NUM_RAYS];	// -tan( fov / 2 ) .. tan( fov / 2 )
+	int32_t		offsetFix[NUM_RAYS];
+} RayCamera;
+RayCamera rayCamera;
+
+// Rebuild the column tables if the FOV changed.
+void SetupRayCamera( RayCamera* cam, float fov ) {
+	if( cam->ready && cam->fov == fov ) return;
+	if( !fixSinTableReady ) InitFixSinTable();
+
+	float planeLen = tanf( fov / 2 );
+	int halfFov = FixAngle( fov / 2 );
+	int64_t planeLenFix = ( ( int64_t )FixSin( halfFov ) << FIX_SHIFT ) / FixCos( halfFov );
+
+	for( int i = 0; i < NUM_RAYS; i++ ) {
+		int cameraX = 2 * i - ( NUM_RAYS - 1 );
+		cam->offset[i] = planeLen * cameraX / ( NUM_RAYS - 1 );
+		cam->offsetFix[i] = ( int32_t )( planeLenFix * cameraX / ( NUM_RAYS - 1 ) );
+	}
+
+	cam->fov = fov;
+	cam->projectedPlane = ( 800 / 2 ) / planeLen;
+	cam->ready = true;
+}
+
+//=======================
+// RAY CACHE
+//=======================
+// Wall columns are only re-cast when the player pose changes. While the
+// pose holds still, a door flipping between blocking and open invalidates
+// just the columns whose rays crossed that door cell.
+
+typedef struct {
+	float		distance;		// Perpendicular to the camera plane
+	float		wallHeight;
+	int			texX;
+	Color		shade;
+} RayColumn;
+
+// Column i owns links[i * RAY_MAX_TRACE ..], one per door cell its ray
+// crossed, threaded into that cell's list.
+typedef struct {
+	int			cell;
+	int			prev;
+	int			next;
+} RayLink;
+
+typedef struct {
+	bool		valid;
+	bool		untracked;		// A ray crossed too many doors, any door change rebuilds everything
+	bool		fixedPoint;
+	float		x, y;
+	float		angle;
+	float		fov;
+	float		dirX, dirY;		// View direction for the cached pose
+	int32_t		dirXFix, dirYFix;
+	RayColumn	columns[NUM_RAYS];
+	bool		dirty[NUM_RAYS];
+	int			dirtyCount;
+	int			cellHead[MAP_WIDTH * MAP_HEIGHT];	// Per-cell list of the columns that crossed it
+	RayLink		links[RAY_LINK_POOL];
+	int			linkCounts[NUM_RAYS];
+} RayCache;
+RayCache rayCache;
+
+// Mark the columns whose rays crossed a map cell for re-casting.
+void InvalidateRayCell( RayCache* cache, int index ) {
+	if( !cache->valid ) return;
+	if( cache->untracked ) {
+		cache->valid = false;
+		return;
+	}
+
+	for( int link = cache->cellHead[index]; link != -1; link = cache->links[link].next ) {
+		int column = link / RAY_MAX_TRACE;
+		if( !cache->dirty[column] ) {
+			cache->dirty[column] = true;
+			cache->dirtyCount++;
+		}
+	}
+}
+
+// Drop a column's links from every cell list before it is re-cast.
+void UnlinkRayColumn( RayCache* cache, int i ) {
+	for( int t = 0; t < cache->linkCounts[i]; t++ ) {
+		RayLink* link = &cache->links[i * RAY_MAX_TRACE + t];
+		if( link->prev != -1 ) {
+			cache->links[link->prev].next = link->next;
+		} else {
+			cache->cellHead[link->cell] = link->next;
+		}
+		if( link->next != -1 ) {
+			cache->links[link->next].prev = link->prev;
+		}
+	}
+	cache->linkCounts[i] = 0;
+}
+
+void CastRayColumn( RayCache* cache, const RayCamera* cam, const Player* player, Map* m, int i ) {
+	int side = 0, texX = 0, hitType = 0;
+	RayTrace trace;
+	float distance;
+
+	// Step along the camera plane, perpendicular to the view direction.
+	if( cache->fixedPoint ) {
+		int32_t rayDirX = cache->dirXFix - FixMul( cache->dirYFix, cam->offsetFix[i] );
+		int32_t rayDirY = cache->dirYFix + FixMul( cache->dirXFix, cam->offsetFix[i] );
+		distance = CastRayFixed( player, m, rayDirX, rayDirY, &side, &texX, &hitType, &trace );
+	} else {
+		float rayDirX = cache->dirX - cache->dirY * cam->offset[i];
+		float rayDirY = cache->dirY + cache->dirX * cam->offset[i];
+		distance = CastRayDir( player, m, rayDirX, rayDirY, &side, &texX, &hitType, &trace );
+	}
+
+	float brightness = fmaxf( 0.2f, 1.0f - ( distance / 10.0f ) );
+	brightness = brightness * brightness;
+	Color shade = ( Color ){ ( unsigned char )( 255 * brightness ),
+							 ( unsigned char )( 255 * brightness ),
+							 ( unsigned char )( 255 * brightness ), 255 };
+	if( hitType == 2 ) {
+		shade = ( Color ){ 150, 75, 0, 255 };
+	}
+
+	RayColumn* col = &cache->columns[i];
+	col->distance = distance;
+	col->wallHeight = cam->projectedPlane / ( distance + 0.1f );
+	col->texX = texX;
+	col->shade = shade;
+
+	if( trace.overflow ) cache->untracked = true;
+	UnlinkRayColumn( cache, i );
+	for( int t = 0; t < trace.count; t++ ) {
+		int cell = trace.cells[t];
+		int link = i * RAY_MAX_TRACE + t;
+		cache->links[link].cell = cell;
+		cache->links[link].prev = -1;
+		cache->links[link].next = cache->cellHead[cell];
+		if( cache->cellHead[cell] != -1 ) {
+			cache->links[cache->cellHead[cell]].prev = link;
+		}
+		cache->cellHead[cell] = link;
+	}
+	cache->linkCounts[i] = trace.count;
+}
+
+// Bring the cached columns up to date for this frame's pose.
+void UpdateRayCache( RayCache* cache, const RayCamera* cam, const Player* player, Map* m ) {
+	if( !cache->valid || cache->x != player->x || cache->y != player->y ||
+		cache->angle != player->angle || cache->fov != cam->fov ||
+		cache->fixedPoint != cam->fixedPoint ) {
+		cache->valid = true;
+		cache->untracked = false;
+		cache->fixedPoint = cam->fixedPoint;
+		cache->x = player->x;
+		cache->y = player->y;
+		cache->angle = player->angle;
+		cache->fov = cam->fov;
+		cache->dirX = cosf( player->angle );
+		cache->dirY = sinf( player->angle );
+		cache->dirXFix = FixCos( FixAngle( player->angle ) );
+		cache->dirYFix = FixSin( FixAngle( player->angle ) );
+		memset( cache->cellHead, -1, sizeof( cache->cellHead ) );
+		for( int i = 0; i < NUM_RAYS; i++ ) {
+			cache->linkCounts[i] = 0;
+			cache->dirty[i] = true;
+		}
+		cache->dirtyCount = NUM_RAYS;
+	}
+
+	if( cache->dirtyCount == 0 ) return;
+
+	for( int i = 0; i < NUM_RAYS; i++ ) {
+		if( cache->dirty[i] ) {
+			CastRayColumn( cache, cam, player, m, i );
+			cache->dirty[i] = false;
+		}
+	}
+	cache->dirtyCount = 0;
+}
+
 void InitParticles( Player* player ) {
 	for( int i = 0; i < MAX_PARTICLES; i++ ) {
 		particles[i].lifetime = 0.0f;
@@ -257,49 +619,175 @@ void SpawnRandEntities( Entity* entities, int count, Map* m ) {
 }
 
 // Update enemy by moving it toward player, if not too close.
-void UpdateEntities( Entity* entities, int count, const Player* player, Map* m, float dt ) {
-	for( int i = 0; i < count; i++ ) {
-		float newX = entities[i].x;
-		float newY = entities[i].y;
-
-		switch( entities[i].behavior ) {
-			case 0: // Chase player
-			{
-				float dx = player->x - entities[i].x;
-				float dy = player->y - entities[i].y;
-				float distance = sqrtf( dx * dx + dy * dy );
-				if( distance > 0.5f ) {
-					newX += ( dx / distance ) * entities[i].speed * dt;
-					newY += ( dy / distance ) * entities[i].speed * dt;
-				}
+void UpdateEntity( Entity* e, const Player* player, Map* m, float dt ) {
+	float newX = e->x;
+	float newY = e->y;
+
+	switch( e->behavior ) {
+		case 0: // Chase player
+		{
+			float dx = player->x - e->x;
+			float dy = player->y - e->y;
+			float distance = sqrtf( dx * dx + dy * dy );
+			if( distance > 0.5f ) {
+				newX += ( dx / distance ) * e->speed * dt;
+				newY += ( dy / distance ) * e->speed * dt;
 			}
-			break;
-			case 1: // Wander randomly
-			{
-				static float wanderTimer = 0.0f;
-				wanderTimer += dt;
-				if( wanderTimer > 1.0f ) {
-					newX += ( ( float )rand() / RAND_MAX - 0.5f ) * entities[i].speed * dt * 2.0f;
-					newY += ( ( float )rand() / RAND_MAX - 0.5f ) * entities[i].speed * dt * 2.0f;
-					wanderTimer = 0.0f;
-				}
+		}
+		break;
+		case 1: // Wander randomly
+		{
+			// Fixed size nudge once a second, so the walk doesn't depend
+			// on how the scheduler split up dt.
+			e->wanderTimer += dt;
+			while( e->wanderTimer > 1.0f ) {
+				newX += ( ( float )rand() / RAND_MAX - 0.5f ) * e->speed * WANDER_NUDGE;
+				newY += ( ( float )rand() / RAND_MAX - 0.5f ) * e->speed * WANDER_NUDGE;
+				e->wanderTimer -= 1.0f;
 			}
+		}
+		break;
+		case 2: // Stationary
 			break;
-			case 2: // Stationary
-				break;
+	}
+
+	// Collision check
+	int newCellX = ( int )newX;
+	int newCellY = ( int )newY;
+	if( isPassable( newCellX, newCellY ) ) {
+		e->x = newX;
+		e->y = newY;
+	}
+	// Simple slide (keep original position if blocked)
+}
+
+//=======================
+// AI SCHEDULER
+//=======================
+// Entities think at a rate picked from their distance to the player.
+// Nearby entities run every tick. The rest are phased across the ticks of
+// their interval and visited by a round-robin cursor, so a tick never
+// scans or updates more than a fixed number of them. Skipped time is
+// handed over as accumulated dt on the next update.
+
+typedef struct {
+	unsigned int tick;
+	double		clock;
+	int			cursor;
+	int			nearby[NUM_ENTITIES];	// Interval 1 entities, updated outside the budget
+	int			nearbyCount;
+} AIScheduler;
+AIScheduler aiScheduler;
+
+// Ticks between updates for an entity, based on how close and visible it is.
+int GetEntityUpdateInterval( const Entity* e, const Player* player ) {
+	float dx = e->x - player->x;
+	float dy = e->y - player->y;
+	float distance = sqrtf( dx * dx + dy * dy );
+
+	if( distance < 8.0f ) return 1;
+	if( distance < 16.0f ) {
+		// Full rate inside the view cone, where the player can see it move.
+		float facing = ( dx * cosf( player->angle ) + dy * sinf( player->angle ) ) / distance;
+		return facing > cosf( player->fov / 2 ) ? 1 : 2;
+	}
+	if( distance < 32.0f ) return 4;
+	return AI_MAX_INTERVAL;
+}
+
+// Advance an entity by its accumulated dt in steps no longer than
+// AI_MAX_STEP, so collision checks can't be skipped. After a hitch or a
+// long starve, time beyond AI_MAX_CATCHUP is dropped to bound the cost.
+void CatchUpEntity( Entity* e, const Player* player, Map* m, float elapsed ) {
+	if( elapsed > AI_MAX_CATCHUP ) elapsed = AI_MAX_CATCHUP;
+
+	int steps = ( int )ceilf( elapsed / AI_MAX_STEP );
+	if( steps < 1 ) steps = 1;
+
+	float stepDt = elapsed / steps;
+	for( int s = 0; s < steps; s++ ) {
+		UpdateEntity( e, player, m, stepDt );
+	}
+}
+
+// Next tick an entity is due, phased by its index so entities sharing an
+// interval are split evenly across the ticks of that interval.
+unsigned int GetEntityNextTick( unsigned int tick, int index, int interval ) {
+	return tick + interval - ( ( index + tick ) % interval );
+}
+
+void RunScheduledEntity( AIScheduler* sched, Entity* e, const Player* player, Map* m ) {
+	CatchUpEntity( e, player, m, ( float )( sched->clock - e->lastUpdate ) );
+	e->lastUpdate = sched->clock;
+}
+
+// Move an entity onto an interval, joining the nearby list for interval 1.
+void ScheduleEntity( AIScheduler* sched, Entity* entities, int index, int interval ) {
+	Entity* e = &entities[index];
+	if( interval == 1 && e->interval != 1 ) {
+		sched->nearby[sched->nearbyCount++] = index;
+	}
+	e->interval = interval;
+	e->nextTick = GetEntityNextTick( sched->tick, index, interval );
+}
+
+// Seed every entity on the interval for its starting distance.
+// The nearby list holds NUM_ENTITIES, so count is capped there.
+void InitAIScheduler( AIScheduler* sched, Entity* entities, int count, const Player* player ) {
+	if( count > NUM_ENTITIES ) count = NUM_ENTITIES;
+
+	sched->tick = 0;
+	sched->clock = 0.0;
+	sched->cursor = 0;
+	sched->nearbyCount = 0;
+	for( int i = 0; i < count; i++ ) {
+		entities[i].lastUpdate = 0.0;
+		entities[i].interval = 0;
+		ScheduleEntity( sched, entities, i, GetEntityUpdateInterval( &entities[i], player ) );
+	}
+}
+
+void UpdateEntitiesScheduled( AIScheduler* sched, Entity* entities, int count, const Player* player, Map* m, float dt ) {
+	if( count > NUM_ENTITIES ) count = NUM_ENTITIES;
+
+	sched->tick++;
+	sched->clock += dt;
+
+	// Nearby entities every tick, dropping back to a bucket once they're far.
+	for( int n = sched->nearbyCount - 1; n >= 0; n-- ) {
+		int index = sched->nearby[n];
+		Entity* e = &entities[index];
+		RunScheduledEntity( sched, e, player, m );
+
+		int interval = GetEntityUpdateInterval( e, player );
+		if( interval != 1 ) {
+			sched->nearby[n] = sched->nearby[--sched->nearbyCount];
+			ScheduleEntity( sched, entities, index, interval );
 		}
+	}
 
-		// Collision check
-		int newCellX = ( int )newX;
-		int newCellY = ( int )newY;
-		if( isPassable( newCellX, newCellY ) ) {
-			entities[i].x = newX;
-			entities[i].y = newY;
-		} else {
-			// Simple slide (keep original position if blocked)
-			entities[i].x = entities[i].x;
-			entities[i].y = entities[i].y;
+	int scanned = 0;
+	int updated = 0;
+	while( scanned < count && scanned < AI_SCAN_PER_TICK && updated < AI_BUDGET_PER_TICK ) {
+		if( sched->cursor >= count ) sched->cursor = 0;
+		int index = sched->cursor++;
+		Entity* e = &entities[index];
+		scanned++;
+
+		if( e->interval == 1 ) continue;
+
+		// Pull the due tick in if the entity moved into a faster bucket.
+		int interval = GetEntityUpdateInterval( e, player );
+		if( interval < e->interval ) {
+			unsigned int due = GetEntityNextTick( sched->tick - 1, index, interval );
+			if( due < e->nextTick ) e->nextTick = due;
 		}
+
+		if( sched->tick < e->nextTick ) continue;
+
+		RunScheduledEntity( sched, e, player, m );
+		ScheduleEntity( sched, entities, index, GetEntityUpdateInterval( e, player ) );
+		updated++;
 	}
 }
 
@@ -318,7 +806,7 @@ void DrawEntities( Entity* entities, int count, const Player* player, Map* m ) {
 			if( fabsf( entityAngle ) < player->fov / 2 ) {
 				// Use CastRay to check occlusion
 				int side, texX, hitType;
-				float occlusionDistance = CastRay( player, m, entityAngle + player->angle, &side, &texX, &hitType );
+				float occlusionDistance = CastRay( player, m, entityAngle + player->angle, &side, &texX, &hitType, NULL );
 
 				// If the ray hits a wall before the entity, it's occluded
 				bool occluded = ( occlusionDistance <= distance && occlusionDistance < 16.0f );
@@ -390,6 +878,7 @@ void UpdateDoors( Map* m, float dt ) {
 		for( int x = 0; x < MAP_WIDTH; x++ ) {
 			int index = y * MAP_WIDTH + x;
 			if( m->data[index] == 2 && m->doorTimers[index] > 0 ) { // Only check doors with active timers
+				bool wasBlocking = m->doorOpenness[index] < 0.5f;
 				m->doorTimers[index] -= dt;
 				if( m->doorTimers[index] < 0.0f ) m->doorTimers[index] = 0.0f; // Prevent negative timer
 
@@ -421,6 +910,9 @@ void UpdateDoors( Map* m, float dt ) {
 					case CLOSED:
 						break;
 				}
+				if( ( m->doorOpenness[index] < 0.5f ) != wasBlocking ) {
+					InvalidateRayCell( &rayCache, index );
+				}
 				//printf( "Door %d,%d openness: %f, timer: %f, state: %d\n", x, y, m->doorOpenness[index], m->doorTimers[index], m->doorStates[index] ); // Debug only active doors
 			}
 		}
@@ -469,12 +961,13 @@ int main( void ) {
 	//==============================
    // 5 is max Y for monster closet
    //===============================
-	entities[0] = ( Entity ){ 2.0f, 2.0f, 1.0f, ( Color ) { 255, 0, 0, 200 }, 0 };     // Red, fast chase
-	entities[1] = ( Entity ){ 2.0f, 4.0f, 0.5f, ( Color ) { 0, 255, 0, 200 }, 1 };   // Green, slow wander
-	entities[2] = ( Entity ){ 4.0f, 2.0f, 0.0f, ( Color ) { 0, 0, 255, 200 }, 2 };   // Blue, stationary
-	entities[3] = ( Entity ){ 2.0f, 6.0f, 1.5f, ( Color ) { 255, 255, 0, 200 }, 0 }; // Yellow, very fast chase
-	entities[4] = ( Entity ){ 6.0f, 2.0f, 0.7f, ( Color ) { 0, 255, 255, 200 }, 1 }; // Cyan, moderate wander
-	entities[5] = ( Entity ){ 4.0f, 4.0f, 0.0f, ( Color ) { 255, 0, 255, 200 }, 2 }; // Magenta, stationary	// Magenta, stationary
+	entities[0] = ( Entity ){ .x = 2.0f, .y = 2.0f, .speed = 1.0f, .color = ( Color ) { 255, 0, 0, 200 }, .behavior = 0 };     // Red, fast chase
+	entities[1] = ( Entity ){ .x = 2.0f, .y = 4.0f, .speed = 0.5f, .color = ( Color ) { 0, 255, 0, 200 }, .behavior = 1 };   // Green, slow wander
+	entities[2] = ( Entity ){ .x = 4.0f, .y = 2.0f, .speed = 0.0f, .color = ( Color ) { 0, 0, 255, 200 }, .behavior = 2 };   // Blue, stationary
+	entities[3] = ( Entity ){ .x = 2.0f, .y = 6.0f, .speed = 1.5f, .color = ( Color ) { 255, 255, 0, 200 }, .behavior = 0 }; // Yellow, very fast chase
+	entities[4] = ( Entity ){ .x = 6.0f, .y = 2.0f, .speed = 0.7f, .color = ( Color ) { 0, 255, 255, 200 }, .behavior = 1 }; // Cyan, moderate wander
+	entities[5] = ( Entity ){ .x = 4.0f, .y = 4.0f, .speed = 0.0f, .color = ( Color ) { 255, 0, 255, 200 }, .behavior = 2 }; // Magenta, stationary	// Magenta, stationary
+	InitAIScheduler( &aiScheduler, entities, NUM_ENTITIES, &player );
 
 	RenderTexture2D target = LoadRenderTexture( 800, 600 );
 
@@ -519,6 +1012,9 @@ int main( void ) {
 		if( IsKeyPressed( KEY_E ) ) {
 			ToggleDoor( &player, &map );
 		}
+		if( IsKeyPressed( KEY_F2 ) ) {
+			rayCamera.fixedPoint = !rayCamera.fixedPoint;
+		}
 
 		// Handle Movement using WASD (strafe uses 0.7 multiplier).
 		float newX = player.x;
@@ -589,7 +1085,7 @@ int main( void ) {
 
 
 		UpdateDoors( &map, dt );
-		UpdateEntities( entities, NUM_ENTITIES, &player, &map, dt );
+		UpdateEntitiesScheduled( &aiScheduler, entities, NUM_ENTITIES, &player, &map, dt );
 		UpdateParticles( dt );
 		if( rand() % 60 == 0 ) {
 			SpawnParticle( &player );
@@ -624,39 +1120,25 @@ int main( void ) {
 		}
 
 
+		SetupRayCamera( &rayCamera, player.fov );
+		UpdateRayCache( &rayCache, &rayCamera, &player, &map );
+
 		float columnWidth = ( float )800 / NUM_RAYS;
 		for( int i = 0; i < NUM_RAYS; i++ ) {
-			// Calculate ray angle for this column.
-			float rayAngle = player.angle - ( player.fov / 2 ) + ( ( float )i / ( NUM_RAYS - 1 ) ) * player.fov;
-			int side = 0, texX = 0, hitType = 0;
-			float distance = CastRay( &player, &map, rayAngle, &side, &texX, &hitType );
-
-			// Correct the distance to reduce fisheye distortion.
-			float correctedDistance = distance * cosf( rayAngle - player.angle );
-			float projectedPlane = ( 800 / 2 ) / tanf( player.fov / 2 );
-			float wallHeight = projectedPlane / ( correctedDistance + 0.1f );
-
-			float brightness = fmaxf( 0.2f, 1.0f - ( correctedDistance / 10.0f ) );
-			brightness = powf( brightness, 2.0f );
-			Color shade = ( Color ){ ( unsigned char )( 255 * brightness ),
-									 ( unsigned char )( 255 * brightness ),
-									 ( unsigned char )( 255 * brightness ), 255 };
-			if( hitType == 2 ) {
-				shade = ( Color ){ 150, 75, 0, 255 };
-			}
+			const RayColumn* col = &rayCache.columns[i];
 
-			//float fogIntensity = fminf( 1.0f, correctedDistance / 8.0f );
+			//float fogIntensity = fminf( 1.0f, col->distance / 8.0f );
 			//Color fogColor = ( Color ){
 			//	( unsigned char )( 100 * fogIntensity ),	// Light Gray
 			//	( unsigned char )( 100 * fogIntensity ),
 			//	( unsigned char )( 100 * fogIntensity ),
 			//	( unsigned char )( 100 * fogIntensity )
 			//};
-			//DrawRectangle( i* columnWidth, ( SCREEN_H - wallHeight ) / 2, columnWidth, wallHeight, fogColor );
+			//DrawRectangle( i* columnWidth, ( SCREEN_H - col->wallHeight ) / 2, columnWidth, col->wallHeight, fogColor );
 
-			Rectangle srcRect = { ( float )texX, 0, 1, ( float )wallTexture.height };
-			Rectangle destRect = { i * columnWidth, ( 600 - wallHeight ) / 2, columnWidth, wallHeight };
-			DrawTexturePro( wallTexture, srcRect, destRect, ( Vector2 ) { 0, 0 }, 0.0f, shade );
+			Rectangle srcRect = { ( float )col->texX, 0, 1, ( float )wallTexture.height };
+			Rectangle destRect = { i * columnWidth, ( 600 - col->wallHeight ) / 2, columnWidth, col->wallHeight };
+			DrawTexturePro( wallTexture, srcRect, destRect, ( Vector2 ) { 0, 0 }, 0.0f, col->shade );
 
 
 		}